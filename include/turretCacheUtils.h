@@ -0,0 +1,67 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ctime>
+
+#include "turretClient.h"
+
+namespace turret_client
+{
+    typedef std::map<std::string, turretQueryCache> turretCacheMap;
+
+    struct turretCacheMergeOptions {
+        bool dropFallbacks = false; // drop NOT_FOUND and $DEFAULT_USD entries
+        std::string defaultUSD; // value treated as a DEFAULT_USD fallback, ignored if empty
+        std::time_t minTimestamp = 0; // drop entries resolved before this time, 0 keeps everything
+        int maxConcurrency = 0; // number of input files loaded at once, 0 lets tbb decide
+    };
+
+    struct turretCacheMergeResult {
+        bool written = false; // false if the output could not be written
+        size_t entries = 0; // number of entries in the output
+        std::vector<std::string> failedInputs; // inputs which could not be read, these are skipped
+    };
+
+    // Reading and writing of .turretcache files, shared by turretClient and the cache tools.
+    class turretCacheUtils {
+        public:
+            static bool read_cache_file(const std::string& a_cachePath, turretCacheMap& a_entries);
+            static bool write_cache_file(const std::string& a_cachePath, const turretCacheMap& a_entries);
+            static bool is_fallback(const turretQueryCache& a_entry, const std::string& a_defaultUSD);
+
+            // Sorts the query parameters, so the same query written with parameters in a different
+            // order maps to the same cache key, eg: "tank:/s118/x?Step=model&Asset=a" becomes
+            // "tank:/s118/x?Asset=a&Step=model". Empty parameters are dropped.
+            static std::string canonical_query(const std::string& a_query);
+
+            // Appends each input file, and each *.turretcache file directly inside each input directory, to a_cachePaths.
+            // Files found in directories must also start with a_prefix (eg: "usd_"), input files are always kept.
+            static void find_cache_files(const std::vector<std::string>& a_inputs, std::vector<std::string>& a_cachePaths,
+                                         const std::string& a_prefix = "");
+
+            // Merges a_inputPaths into a_outputPath, keeping the newest entry per key.
+            static turretCacheMergeResult merge_cache_files(const std::vector<std::string>& a_inputPaths,
+                                                            const std::string& a_outputPath,
+                                                            const turretCacheMergeOptions& a_options);
+    };
+}
@@ -20,6 +20,8 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <memory>
 #include <ctime>
 
 #include <boost/serialization/serialization.hpp>
@@ -27,9 +29,17 @@
 #include "tbb/concurrent_hash_map.h"
 #include "tbb/mutex.h"
 #include "tbb/tbb_thread.h"
+#include "tbb/spin_rw_mutex.h"
+
+namespace zmq
+{
+    class context_t;
+}
 
 namespace turret_client
 {
+    class turretPrefetcher;
+
     const std::string TANK_PREFIX = "tank://";
     const std::string TANK_PREFIX_SHORT = "tank:";
 
@@ -39,9 +49,14 @@ namespace turret_client
     const int DEFAULT_ZMQ_TIMEOUT = 60000;
     const int DEFAULT_ZMQ_RETRIES = 50;
 
+    const int DEFAULT_RESOLVE_CONCURRENCY = 16; // threads used by resolve_names
+
     const std::string TURRET_CACHE_DIR = "/usr/tmp/turret/";
     const std::string TURRET_CACHE_EXT = ".turretcache";
 
+    // Appended to a query to ask the server for every match in scope, see resolve_scope
+    const std::string TURRET_SCOPE_ARG = "turret_scope=1";
+
     struct turretQueryCache {
         std::string resolved_path;
         std::time_t timestamp;
@@ -64,6 +79,11 @@ namespace turret_client
             std::string resolve_name(const std::string& a_path);
             bool resolve_exists(const std::string& a_path);
             bool matches_schema(const std::string& a_path);
+            std::vector<std::string> resolve_names(const std::vector<std::string>& a_paths,
+                                                   int a_maxConcurrency = DEFAULT_RESOLVE_CONCURRENCY);
+            size_t resolve_scope(const std::string& a_scopeQuery);
+            bool load_cache(const std::string& a_cachePath);
+            bool save_cache(const std::string& a_cachePath, bool a_dropFallbacks = false);
             void SetClientID(const char* a_clientID) { m_clientID = std::string(a_clientID); }
             const char* GetClientID() { return m_clientID.c_str(); }
 
@@ -71,9 +91,20 @@ namespace turret_client
             void setup();
             void destroy();
             std::string parse_query(const std::string& a_query);
+            std::string buildQuery(const std::string& a_query);
+            bool sendQuery(const std::string& a_query, std::string& a_reply, int a_timeout = -1);
             void saveCache();
             void clearCache();
             bool loadCache();
+            bool writeCacheFile(const std::string& a_cachePath, bool a_dropFallbacks = false);
+            bool readCacheFile(const std::string& a_cachePath);
+            zmq::context_t& getContext();
+            bool cacheFind(const std::string& a_query, turretQueryCache& a_cache);
+            bool cacheInsert(const std::string& a_query, const turretQueryCache& a_cache, bool a_prefetched = false);
+            void claimPrefetched(const std::string& a_query);
+            void queuePrefetches(const std::string& a_query);
+            void prefetch(const std::string& a_query);
+            void prefetchLoop();
             void appendCache();
             std::string m_clientID; // set by constructor
             std::string m_serverIP;
@@ -90,5 +121,15 @@ namespace turret_client
             std::string m_cacheFilePath;
             std::string m_cacheDir;
             tbb::concurrent_hash_map<std::string, turretQueryCache> m_cachedQueries;
+            tbb::spin_rw_mutex m_cacheMutex; // readers look up and insert into m_cachedQueries, a writer iterates it
+            std::unique_ptr<zmq::context_t> m_context; // shared by all live resolves, recreated after fork()
+            long m_contextPid; // pid of the process which created m_context
+            tbb::mutex m_contextMutex;
+            std::unique_ptr<turretPrefetcher> m_prefetcher; // set by env var $TURRET_CLIENTID_PREFETCH_HISTORY
+            struct prefetchState; // prefetch queue and threads, see turretClient.cpp
+            std::unique_ptr<prefetchState> m_prefetchState;
+            tbb::concurrent_hash_map<std::string, bool> m_prefetchQueued;
+            tbb::concurrent_hash_map<std::string, bool> m_prefetchedUnused; // prefetched but not yet resolved, never saved
+            long m_prefetchPid; // pid of the process which started the prefetch threads
     };
 }
@@ -0,0 +1,50 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace turret_client
+{
+    const int PREFETCH_WINDOW_SECONDS = 30; // entries resolved within this long after a query are treated as following it
+    const size_t PREFETCH_MAX_FOLLOWERS = 64; // followers counted per entry when building the model, in whole seconds
+    const int PREFETCH_MAX_PREDICTIONS = 8; // predictions kept per query
+    const size_t PREFETCH_MAX_HISTORY_FILES = 32; // newest history files read, keeps client startup cheap
+    const int PREFETCH_THREADS = 2; // threads resolving prefetches in the background
+    const size_t PREFETCH_MAX_QUEUED = 256; // prefetches beyond this are dropped
+    const int PREFETCH_TIMEOUT = 5000; // ms, bounds how long a prefetch can hold up the client's destructor
+
+    // Predicts which queries will be needed next, from the order queries were resolved in
+    // previous sessions' cache files (see turretQueryCache::timestamp).
+    class turretPrefetcher {
+        public:
+            // Builds the model from the newest PREFETCH_MAX_HISTORY_FILES of a set of cache files.
+            // Timestamps are whole seconds, so entries resolved in the same second follow each other,
+            // as do entries from later seconds within PREFETCH_WINDOW_SECONDS. Fallback entries are ignored.
+            // Returns the number of queries which have predictions.
+            size_t load_history(const std::vector<std::string>& a_cachePaths, const std::string& a_defaultUSD);
+            const std::vector<std::string>& predict(const std::string& a_query) const;
+            bool empty() const { return m_predictions.empty(); }
+
+        private:
+            std::unordered_map<std::string, std::vector<std::string>> m_predictions;
+    };
+}
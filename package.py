@@ -37,4 +37,6 @@ variants = [
 def commands():
     env.LIBTURRET_ROOT.set("{this.root}")
     env.LD_LIBRARY_PATH.append('{root}/lib')
+    env.PYTHONPATH.append('{root}/python')
+    env.PATH.append('{root}/bin')
     env.TURRET_RETRIES.set("1")
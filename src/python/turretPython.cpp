@@ -0,0 +1,122 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <Python.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/stl_iterator.hpp>
+
+#include "turretClient.h"
+
+/* Python bindings for turretClient.
+ *
+ * All calls that may block on a live resolve or on disk io release the GIL, so a
+ * single client (and its in-memory cache) can be shared between python threads.
+ *
+ *   import turret_client
+ *   client = turret_client.TurretClient("usd")
+ *   client.resolve_names(["tank:/s118/...", "tank:/s118/..."], max_concurrency=32)
+ *   client.save_cache("/usr/tmp/turret/scan.turretcache")
+ */
+
+namespace bp = boost::python;
+
+namespace {
+
+    // Releases the GIL for the lifetime of the object. No python api may be used while it is alive.
+    class ScopedGILRelease {
+        public:
+            ScopedGILRelease() : m_threadState(PyEval_SaveThread()) {}
+            ~ScopedGILRelease() { PyEval_RestoreThread(m_threadState); }
+
+        private:
+            ScopedGILRelease(const ScopedGILRelease&) = delete;
+            ScopedGILRelease& operator=(const ScopedGILRelease&) = delete;
+            PyThreadState* m_threadState;
+    };
+
+    std::string resolveName(turret_client::turretClient& a_client, const std::string& a_path) {
+        ScopedGILRelease release;
+        return a_client.resolve_name(a_path);
+    }
+
+    bool resolveExists(turret_client::turretClient& a_client, const std::string& a_path) {
+        ScopedGILRelease release;
+        return a_client.resolve_exists(a_path);
+    }
+
+    bp::list resolveNames(turret_client::turretClient& a_client, const bp::object& a_paths, int a_maxConcurrency) {
+        // Copy out of python objects while the GIL is still held
+        bp::stl_input_iterator<std::string> begin(a_paths), end;
+        std::vector<std::string> paths(begin, end);
+        std::vector<std::string> resolvedPaths;
+
+        {
+            ScopedGILRelease release;
+            resolvedPaths = a_client.resolve_names(paths, a_maxConcurrency);
+        }
+
+        bp::list result;
+        for (const std::string& resolvedPath : resolvedPaths) {
+            result.append(resolvedPath);
+        }
+
+        return result;
+    }
+
+    size_t resolveScope(turret_client::turretClient& a_client, const std::string& a_scopeQuery) {
+        ScopedGILRelease release;
+        return a_client.resolve_scope(a_scopeQuery);
+    }
+
+    bool loadCache(turret_client::turretClient& a_client, const std::string& a_cachePath) {
+        ScopedGILRelease release;
+        return a_client.load_cache(a_cachePath);
+    }
+
+    bool saveCache(turret_client::turretClient& a_client, const std::string& a_cachePath, bool a_dropFallbacks) {
+        ScopedGILRelease release;
+        return a_client.save_cache(a_cachePath, a_dropFallbacks);
+    }
+
+    std::string getClientID(turret_client::turretClient& a_client) {
+        return std::string(a_client.GetClientID());
+    }
+}
+
+BOOST_PYTHON_MODULE(turret_client)
+{
+    bp::scope().attr("TANK_PREFIX") = turret_client::TANK_PREFIX;
+    bp::scope().attr("TANK_PREFIX_SHORT") = turret_client::TANK_PREFIX_SHORT;
+    bp::scope().attr("TURRET_CACHE_EXT") = turret_client::TURRET_CACHE_EXT;
+
+    bp::class_<turret_client::turretClient, boost::noncopyable>("TurretClient", bp::init<>())
+            .def(bp::init<const char*>(bp::arg("client_id")))
+            .def("resolve_name", &resolveName, bp::arg("path"))
+            .def("resolve_exists", &resolveExists, bp::arg("path"))
+            .def("resolve_names", &resolveNames,
+                 (bp::arg("paths"), bp::arg("max_concurrency") = turret_client::DEFAULT_RESOLVE_CONCURRENCY))
+            .def("resolve_scope", &resolveScope, bp::arg("scope_query"))
+            .def("matches_schema", &turret_client::turretClient::matches_schema, bp::arg("path"))
+            .def("load_cache", &loadCache, bp::arg("cache_path"))
+            .def("save_cache", &saveCache, (bp::arg("cache_path"), bp::arg("drop_fallbacks") = false))
+            .add_property("client_id", &getClientID);
+}
@@ -0,0 +1,260 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+
+#include "turretClient.h"
+
+/* turret_bake
+ *
+ * Scans text scene/layer files (usda, ma, nk...) for tank uris, resolves them through
+ * a turretClient and writes the results out as a cache file, suitable for
+ * TURRET_${CLIENTID}_CACHE_LOCATION.  Farm tasks can then run with
+ * TURRET_${CLIENTID}_ALLOW_LIVE_RESOLVES=0.
+ *
+ * Directories are walked recursively and only files with a matching extension are
+ * scanned.  Files given explicitly are always scanned.
+ *
+ * The bake always resolves live and ignores the client's cache location, cache to disk and
+ * prefetch history environment variables, so the output only depends on the scanned files.
+ */
+
+namespace {
+
+    const std::string DEFAULT_CLIENT_ID = "usd";
+    const std::string DEFAULT_EXTENSIONS = ".usda,.ma,.nk,.klf";
+    const int DEFAULT_JOBS = 16;
+
+    // Characters which end a uri in the file formats we scan, eg: @tank:/...@ in usda or "tank:/..." in maya ascii
+    const std::string URI_TERMINATORS = " \t\r\n\"'@<>()[]{},;`\\";
+
+    void printUsage() {
+        std::cerr << "usage: turret_bake -o <output.turretcache> [-c <client_id>] [-j <jobs>] [-e <.ext,.ext>] [--keep-fallbacks] <file|dir>...\n"
+                  << "  -o  cache file to write\n"
+                  << "  -c  turret client id, must match the consuming client (default: " << DEFAULT_CLIENT_ID << ")\n"
+                  << "  -j  maximum number of concurrent resolves, may exceed the core count (default: " << DEFAULT_JOBS << ")\n"
+                  << "  -e  extensions scanned when walking directories (default: " << DEFAULT_EXTENSIONS << ")\n"
+                  << "  --keep-fallbacks  also write NOT_FOUND/$DEFAULT_USD entries for unresolved uris"
+                  << std::endl;
+    }
+
+    std::set<std::string> splitExtensions(const std::string& a_extensions) {
+        std::set<std::string> extensions;
+        std::stringstream ss(a_extensions);
+        std::string extension;
+
+        while (std::getline(ss, extension, ',')) {
+            if (extension.empty())
+                continue;
+            if (extension[0] != '.')
+                extension = "." + extension;
+            extensions.insert(extension);
+        }
+
+        return extensions;
+    }
+
+    void collectFiles(const std::vector<std::string>& a_inputs, const std::set<std::string>& a_extensions,
+                      std::vector<std::string>& a_files) {
+        for (const std::string& input : a_inputs) {
+            boost::system::error_code ec;
+
+            if (boost::filesystem::is_directory(input, ec)) {
+                boost::filesystem::recursive_directory_iterator it(input, ec), end;
+
+                for (; it != end; it.increment(ec)) {
+                    if (ec)
+                        break;
+                    if (boost::filesystem::is_regular_file(it->path(), ec)
+                        && a_extensions.count(it->path().extension().string())) {
+                        a_files.push_back(it->path().string());
+                    }
+                }
+            } else if (boost::filesystem::is_regular_file(input, ec)) {
+                a_files.push_back(input);
+            } else {
+                std::cerr << "turret_bake: skipping missing input " << input << std::endl;
+            }
+        }
+    }
+
+    void setEnv(const std::string& a_name, const char* a_value) {
+#ifdef _WIN32
+        _putenv_s(a_name.c_str(), a_value ? a_value : "");
+#else
+        if (a_value)
+            setenv(a_name.c_str(), a_value, 1);
+        else
+            unsetenv(a_name.c_str());
+#endif
+    }
+
+    // The bake client must only resolve the scanned uris, live, so the output doesn't depend on the
+    // session it was run from. Override any client settings inherited from the environment.
+    void isolateClientEnvironment(const std::string& a_clientID) {
+        std::string clientIDUppercase = a_clientID;
+        std::transform(clientIDUppercase.begin(), clientIDUppercase.end(), clientIDUppercase.begin(), ::toupper);
+        const std::string prefix = "TURRET_" + clientIDUppercase;
+
+        for (const char* suffix : {"_CACHE_LOCATION", "_RETRY_CACHE_LOAD", "_CACHE_TO_DISK", "_PREFETCH_HISTORY"}) {
+            const std::string name = prefix + suffix;
+            if (std::getenv(name.c_str())) {
+                std::cerr << "turret_bake: ignoring $" << name << std::endl;
+                setEnv(name, nullptr);
+            }
+        }
+
+        const std::string allowLiveResolves = prefix + "_ALLOW_LIVE_RESOLVES";
+        if (const char* value = std::getenv(allowLiveResolves.c_str())) {
+            if (std::string(value) != "1") {
+                std::cerr << "turret_bake: ignoring $" << allowLiveResolves << "=" << value
+                          << ", live resolves are required to bake a cache" << std::endl;
+            }
+        }
+        setEnv(allowLiveResolves, "1");
+    }
+
+    void scanFile(const std::string& a_filePath, turret_client::turretClient& a_client,
+                  std::vector<std::string>& a_uris) {
+        std::ifstream fs(a_filePath.c_str(), std::ios::binary);
+        if (!fs.is_open()) {
+            std::cerr << "turret_bake: could not open " << a_filePath << std::endl;
+            return;
+        }
+
+        const std::string contents((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+
+        size_t pos = contents.find(turret_client::TANK_PREFIX_SHORT);
+        while (pos != std::string::npos) {
+            size_t end = contents.find_first_of(URI_TERMINATORS, pos);
+            if (end == std::string::npos)
+                end = contents.size();
+
+            // Skip matches inside other words (eg: fishtank:/x) and ones which aren't paths (eg: tank:model)
+            const bool startsToken = (pos == 0 || URI_TERMINATORS.find(contents[pos - 1]) != std::string::npos);
+            const size_t pathStart = pos + turret_client::TANK_PREFIX_SHORT.size();
+            const bool isPath = (pathStart < end && contents[pathStart] == '/');
+
+            const std::string uri = contents.substr(pos, end - pos);
+            if (startsToken && isPath && a_client.matches_schema(uri)) {
+                a_uris.push_back(uri);
+            }
+
+            pos = contents.find(turret_client::TANK_PREFIX_SHORT, end);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string outputPath;
+    std::string clientID = DEFAULT_CLIENT_ID;
+    std::string extensions = DEFAULT_EXTENSIONS;
+    int jobs = DEFAULT_JOBS;
+    bool keepFallbacks = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+
+        if (arg == "-o" && hasValue) {
+            outputPath = argv[++i];
+        } else if (arg == "-c" && hasValue) {
+            clientID = argv[++i];
+        } else if (arg == "-j" && hasValue) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-e" && hasValue) {
+            extensions = argv[++i];
+        } else if (arg == "--keep-fallbacks") {
+            keepFallbacks = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (outputPath.empty() || inputs.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    collectFiles(inputs, splitExtensions(extensions), files);
+
+    isolateClientEnvironment(clientID);
+    turret_client::turretClient client(clientID.c_str());
+
+    // Scan files in parallel, each file gets its own result list so no locking is needed
+    std::vector<std::vector<std::string>> urisPerFile(files.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, files.size()),
+                      [&](const tbb::blocked_range<size_t>& a_range) {
+                          for (size_t i = a_range.begin(); i != a_range.end(); ++i) {
+                              scanFile(files[i], client, urisPerFile[i]);
+                          }
+                      });
+
+    std::set<std::string> uniqueUris;
+    for (const std::vector<std::string>& uris : urisPerFile) {
+        uniqueUris.insert(uris.begin(), uris.end());
+    }
+
+    const std::vector<std::string> uris(uniqueUris.begin(), uniqueUris.end());
+    std::cout << "turret_bake: found " << uris.size() << " unique uris in " << files.size() << " files" << std::endl;
+
+    // Bound the number of in-flight queries so a large scan does not flood the server
+    const std::vector<std::string> resolvedPaths = client.resolve_names(uris, jobs);
+
+    const char* defaultUSD = std::getenv("DEFAULT_USD");
+    size_t unresolved = 0;
+    for (size_t i = 0; i < uris.size(); ++i) {
+        if (resolvedPaths[i] == "NOT_FOUND" || resolvedPaths[i] == "Unable to parse query"
+            || resolvedPaths[i] == "uncached_query" || (defaultUSD && resolvedPaths[i] == defaultUSD)) {
+            std::cerr << "turret_bake: unresolved " << uris[i] << std::endl;
+            unresolved++;
+        }
+    }
+
+    // Without fallback entries, farm tasks get $DEFAULT_USD for unresolved uris rather than "NOT_FOUND"
+    if (!client.save_cache(outputPath, !keepFallbacks)) {
+        std::cerr << "turret_bake: could not write cache file " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "turret_bake: wrote " << outputPath << " (" << uris.size() - unresolved << " resolved, "
+              << unresolved << " unresolved)" << std::endl;
+
+    return unresolved ? 2 : 0;
+}
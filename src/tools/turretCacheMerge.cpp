@@ -0,0 +1,126 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "turretClient.h"
+#include "turretCacheUtils.h"
+
+/* turret_cache_merge
+ *
+ * Merges many .turretcache files into a single sorted cache, keeping the newest entry
+ * for each key.  Directories are searched (non-recursively) for *.turretcache files, eg:
+ *
+ *   turret_cache_merge -o s118_master.turretcache --drop-fallbacks --max-age-days 30 /usr/tmp/turret
+ */
+
+namespace {
+
+    const int SECONDS_PER_DAY = 60 * 60 * 24;
+
+    void printUsage() {
+        std::cerr << "usage: turret_cache_merge -o <output.turretcache> [-j <jobs>] [--drop-fallbacks] [--max-age-days <days>] <file|dir>...\n"
+                  << "  -o                cache file to write, may also be one of the inputs\n"
+                  << "  -j                maximum number of input files loaded at once (default: tbb decides)\n"
+                  << "  --drop-fallbacks  drop NOT_FOUND and $DEFAULT_USD entries\n"
+                  << "  --max-age-days    drop entries resolved more than this many days ago"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string outputPath;
+    std::vector<std::string> inputs;
+    turret_client::turretCacheMergeOptions options;
+
+    if (const char* defaultUSD = std::getenv("DEFAULT_USD")) {
+        options.defaultUSD = defaultUSD;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+
+        if (arg == "-o" && hasValue) {
+            outputPath = argv[++i];
+        } else if (arg == "-j" && hasValue) {
+            options.maxConcurrency = std::atoi(argv[++i]);
+        } else if (arg == "--drop-fallbacks") {
+            options.dropFallbacks = true;
+        } else if (arg == "--max-age-days" && hasValue) {
+            const char* value = argv[++i];
+            char* valueEnd = nullptr;
+            const long days = std::strtol(value, &valueEnd, 10);
+
+            // A bad value would otherwise become 0 and silently drop every entry
+            if (valueEnd == value || *valueEnd != '\0' || days <= 0) {
+                std::cerr << "turret_cache_merge: --max-age-days must be a positive number of days, got '"
+                          << value << "'" << std::endl;
+                return 1;
+            }
+
+            options.minTimestamp = std::time(0) - static_cast<std::time_t>(days) * SECONDS_PER_DAY;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (outputPath.empty() || inputs.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    for (const std::string& input : inputs) {
+        boost::system::error_code ec;
+        if (!boost::filesystem::exists(input, ec)) {
+            std::cerr << "turret_cache_merge: skipping missing input " << input << std::endl;
+        }
+    }
+
+    std::vector<std::string> files;
+    turret_client::turretCacheUtils::find_cache_files(inputs, files);
+
+    const turret_client::turretCacheMergeResult result =
+            turret_client::turretCacheUtils::merge_cache_files(files, outputPath, options);
+
+    for (const std::string& failedInput : result.failedInputs) {
+        std::cerr << "turret_cache_merge: could not read cache file " << failedInput << std::endl;
+    }
+
+    if (!result.written) {
+        std::cerr << "turret_cache_merge: could not write cache file " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "turret_cache_merge: merged " << files.size() - result.failedInputs.size() << " of "
+              << files.size() << " files into " << outputPath << " (" << result.entries << " entries)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "turretCacheUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+
+#include <boost/serialization/map.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/filesystem.hpp>
+
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+#include "tbb/task_arena.h"
+
+namespace turret_client {
+
+    bool turretCacheUtils::read_cache_file(const std::string &a_cachePath, turretCacheMap &a_entries) {
+        std::fstream fs(a_cachePath.c_str(), std::fstream::in | std::ios::binary);
+
+        if (!fs.is_open()) {
+            return false;
+        }
+
+        try {
+            boost::archive::text_iarchive iarch(fs);
+            iarch >> a_entries;
+        }
+        catch (const boost::archive::archive_exception &) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool turretCacheUtils::write_cache_file(const std::string &a_cachePath, const turretCacheMap &a_entries) {
+        // Write to a unique temporary file and rename it into place, so readers never see a partial
+        // file and several processes (eg: forked workers) saving to the same path can't interleave.
+        const std::string tmpPath = a_cachePath + boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp").string();
+
+        {
+            std::fstream fs(tmpPath.c_str(), std::fstream::out | std::ios::binary);
+
+            if (!fs.is_open()) {
+                return false;
+            }
+
+            try {
+                boost::archive::text_oarchive oarch(fs);
+                oarch << a_entries;
+            }
+            catch (const boost::archive::archive_exception &) {
+                fs.close();
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+
+            // A failed final flush (eg: disk full) must not replace the existing cache with a truncated one
+            fs.close();
+            if (fs.fail()) {
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+        }
+
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmpPath, a_cachePath, ec);
+
+        if (ec) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool turretCacheUtils::is_fallback(const turretQueryCache &a_entry, const std::string &a_defaultUSD) {
+        if (a_entry.resolved_path == "NOT_FOUND")
+            return true;
+
+        return !a_defaultUSD.empty() && a_entry.resolved_path == a_defaultUSD;
+    }
+
+    std::string turretCacheUtils::canonical_query(const std::string &a_query) {
+        const size_t paramsStart = a_query.find('?');
+        if (paramsStart == std::string::npos)
+            return a_query;
+
+        std::vector<std::string> params;
+        size_t start = paramsStart + 1;
+        while (start <= a_query.size()) {
+            size_t end = a_query.find('&', start);
+            if (end == std::string::npos)
+                end = a_query.size();
+            if (end > start)
+                params.push_back(a_query.substr(start, end - start));
+            start = end + 1;
+        }
+
+        std::sort(params.begin(), params.end());
+
+        std::string query = a_query.substr(0, paramsStart + 1);
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (i > 0)
+                query += '&';
+            query += params[i];
+        }
+
+        return query;
+    }
+
+    void turretCacheUtils::find_cache_files(const std::vector<std::string> &a_inputs,
+                                            std::vector<std::string> &a_cachePaths,
+                                            const std::string &a_prefix) {
+        for (const std::string &input : a_inputs) {
+            boost::system::error_code ec;
+
+            if (boost::filesystem::is_directory(input, ec)) {
+                boost::filesystem::directory_iterator it(input, ec), end;
+
+                for (; it != end; it.increment(ec)) {
+                    if (ec)
+                        break;
+                    if (boost::filesystem::is_regular_file(it->path(), ec)
+                        && it->path().extension().string() == TURRET_CACHE_EXT
+                        && it->path().filename().string().compare(0, a_prefix.size(), a_prefix) == 0) {
+                        a_cachePaths.push_back(it->path().string());
+                    }
+                }
+            } else if (boost::filesystem::is_regular_file(input, ec)) {
+                a_cachePaths.push_back(input);
+            }
+        }
+    }
+
+    turretCacheMergeResult turretCacheUtils::merge_cache_files(const std::vector<std::string> &a_inputPaths,
+                                                               const std::string &a_outputPath,
+                                                               const turretCacheMergeOptions &a_options) {
+        turretCacheMergeResult result;
+
+        // std::map keeps the output sorted by key. Inputs are deserialised in parallel and their
+        // entries moved into it, so peak memory is the merged result plus maxConcurrency inputs.
+        turretCacheMap merged;
+        std::mutex mergedMutex;
+        std::mutex failedMutex;
+
+        auto mergeInputs = [&]() {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, a_inputPaths.size(), 1),
+                              [&](const tbb::blocked_range<size_t> &a_range) {
+                for (size_t i = a_range.begin(); i != a_range.end(); ++i) {
+                    turretCacheMap entries;
+                    if (!read_cache_file(a_inputPaths[i], entries)) {
+                        std::lock_guard<std::mutex> lock(failedMutex);
+                        result.failedInputs.push_back(a_inputPaths[i]);
+                        continue;
+                    }
+
+                    std::lock_guard<std::mutex> lock(mergedMutex);
+
+                    for (turretCacheMap::iterator it = entries.begin(); it != entries.end();) {
+                        turretCacheMap::iterator entry = it++;
+
+                        if (entry->second.timestamp < a_options.minTimestamp)
+                            continue;
+                        if (a_options.dropFallbacks && is_fallback(entry->second, a_options.defaultUSD))
+                            continue;
+
+                        const std::string key = canonical_query(entry->first);
+                        turretCacheMap::iterator existing = merged.find(key);
+                        if (existing == merged.end()) {
+                            turretCacheMap::node_type node = entries.extract(entry);
+                            node.key() = key;
+                            merged.insert(std::move(node));
+                        }
+                        // Newest timestamp wins, ties are broken on the path so output doesn't depend on input order
+                        else if (existing->second.timestamp < entry->second.timestamp
+                                 || (existing->second.timestamp == entry->second.timestamp
+                                     && existing->second.resolved_path < entry->second.resolved_path)) {
+                            existing->second = std::move(entry->second);
+                        }
+                    }
+                }
+            });
+        };
+
+        if (a_options.maxConcurrency > 0) {
+            tbb::task_arena arena(a_options.maxConcurrency);
+            arena.execute(mergeInputs);
+        } else {
+            mergeInputs();
+        }
+
+        std::sort(result.failedInputs.begin(), result.failedInputs.end());
+
+        result.entries = merged.size();
+        result.written = write_cache_file(a_outputPath, merged);
+
+        return result;
+    }
+}
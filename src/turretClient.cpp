@@ -17,8 +17,16 @@
 //
 
 #include "turretClient.h"
+#include "turretCacheUtils.h"
+#include "turretPrefetcher.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <ctime>
 #include <zmq.hpp>
 
@@ -33,6 +41,12 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 #include <boost/serialization/map.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -40,6 +54,7 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/filesystem.hpp>
 
+
 /* Environment Variables:
  *
  * TURRET_SESSION_ID -
@@ -58,9 +73,50 @@
  * destructor is called.
  * This can be set per turret client (eg: usd, klf).
  *
+ * TURRET_${CLIENTID}_PREFETCH_HISTORY -
+ * A list of cache files, or directories of cache files, from previous sessions of the
+ * same show or shot, separated by ':' (';' on windows).  Only the newest
+ * PREFETCH_MAX_HISTORY_FILES are read.  When a query misses the cache, the queries which
+ * followed it in those sessions are resolved in the background.
+ * This can be set per turret client (eg: usd, klf).
+ *
  */
 
+/* fork():
+ *
+ * A zmq context must not be used across a fork.  The client keeps one context for all
+ * live resolves and records the pid that created it.  If a resolve happens in a different
+ * process, the inherited context is abandoned (never closed) and a new one is created.
+ * m_cachedQueries is left as is, so workers forked from a warmed up parent share its
+ * cache as copy-on-write memory.
+ * In a forked child, resolve_name, resolve_names and resolve_scope are supported:
+ * resolve_names starts its own threads rather than using the tbb scheduler, which can't
+ * be used in a child once the parent has started its workers.  Background prefetching
+ * is not restarted in a child.
+ * Forking while another thread is mid-resolve is still unsafe, as that thread may hold
+ * locks in the cache.  Prefetch threads resolve whenever a query misses the cache, so
+ * prefetching must be off ($TURRET_CLIENTID_PREFETCH_HISTORY unset) in processes that fork.
+ */
+
+namespace {
+    long getProcessID() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return getpid();
+#endif
+    }
+}
+
 namespace turret_client {
+    struct turretClient::prefetchState {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::string> queue;
+        std::vector<std::thread> threads;
+        bool stop = false;
+    };
+
     // -- Public
 
     turretClient::turretClient() :
@@ -73,7 +129,9 @@ namespace turret_client {
             m_doLog(true),
             m_resolveFromFileCache(false),
             m_allowLiveResolves(true),
-            m_cacheFilePath("") {
+            m_cacheFilePath(""),
+            m_contextPid(0),
+            m_prefetchPid(0) {
         setup();
     }
 
@@ -86,7 +144,9 @@ namespace turret_client {
             m_retries(turret_client::DEFAULT_ZMQ_RETRIES),
             m_doLog(true),
             m_resolveFromFileCache(false),
-            m_cacheFilePath("") {
+            m_cacheFilePath(""),
+            m_contextPid(0),
+            m_prefetchPid(0) {
         setup();
     }
 
@@ -116,6 +176,105 @@ namespace turret_client {
     bool turretClient::matches_schema(const std::string &a_path) {
         return a_path.find(TANK_PREFIX_SHORT) == 0;
     }
+
+    // Resolves a batch of queries in parallel, results are returned in the same order as a_paths.
+    // Resolves are network bound, so they run on up to a_maxConcurrency dedicated threads rather than
+    // on the shared tbb pool, which is sized to the core count and used by the host application.
+    std::vector<std::string> turretClient::resolve_names(const std::vector<std::string> &a_paths, int a_maxConcurrency) {
+        std::vector<std::string> resolvedPaths(a_paths.size());
+        std::atomic<size_t> next(0);
+
+        auto resolveNext = [&]() {
+            for (size_t i = next++; i < a_paths.size(); i = next++) {
+                resolvedPaths[i] = this->parse_query(a_paths[i]);
+            }
+        };
+
+        const size_t threadCount = std::min(a_paths.size(), static_cast<size_t>(std::max(1, a_maxConcurrency)));
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < threadCount; ++i) {
+            threads.push_back(std::thread(resolveNext));
+        }
+
+        // The calling thread takes a share of the batch too
+        resolveNext();
+
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        return resolvedPaths;
+    }
+
+    // Sends a single scope query (eg: every published Step of an Asset) and caches each entry of the reply,
+    // so later resolve_name calls for those queries are cache hits. Returns the number of entries cached.
+    size_t turretClient::resolve_scope(const std::string &a_scopeQuery) {
+        if (!m_allowLiveResolves) {
+            return 0;
+        }
+
+        const char *separator = (a_scopeQuery.find('?') == std::string::npos) ? "?" : "&";
+        const std::string query = buildQuery(a_scopeQuery + separator + TURRET_SCOPE_ARG);
+
+        std::string reply;
+        bool received = false;
+        for (int i = 0; i < m_retries && !received; i++) {
+            received = sendQuery(query, reply);
+        }
+
+        if (!received || reply == "NOT_FOUND") {
+
+            if (m_doLog) {
+                turretLogger::Instance()->Log(m_clientID + " resolver received no scope response for query: " + query,
+                                              turretLogger::LOG_LEVELS::ZMQ_ERROR);
+            }
+
+            return 0;
+        }
+
+        // One "<query>\t<resolved path>" entry per line
+        const std::time_t timestamp = std::time(0);
+        std::istringstream lines(reply);
+        std::string line;
+        size_t cached = 0;
+
+        while (std::getline(lines, line)) {
+            const size_t tab = line.find('\t');
+            if (tab == std::string::npos || tab == 0 || tab + 1 == line.size())
+                continue;
+
+            const std::string realPath = line.substr(tab + 1);
+            if (realPath == "NOT_FOUND")
+                continue;
+
+            turretQueryCache cache = {realPath, timestamp};
+            // insert will not add duplicate keys
+            if (cacheInsert(buildQuery(line.substr(0, tab)), cache)) {
+                cached++;
+            }
+        }
+
+        if (m_doLog) {
+            turretLogger::Instance()->Log(m_clientID + " resolver cached " + std::to_string(cached)
+                                          + " entries from scope query: " + query,
+                                          turretLogger::LOG_LEVELS::ZMQ_QUERIES);
+        }
+
+        return cached;
+    }
+
+    // Merges the entries of a cache file into the in-memory cache. Existing keys are kept.
+    bool turretClient::load_cache(const std::string &a_cachePath) {
+        return readCacheFile(a_cachePath);
+    }
+
+    // Writes the in-memory cache to a_cachePath, independent of $TURRET_CLIENTID_CACHE_TO_DISK.
+    // With a_dropFallbacks, NOT_FOUND and $DEFAULT_USD entries are left out, so a client
+    // loading the file without live resolves falls back to $DEFAULT_USD instead.
+    bool turretClient::save_cache(const std::string &a_cachePath, bool a_dropFallbacks) {
+        return writeCacheFile(a_cachePath, a_dropFallbacks);
+    }
     // -- End Public
 
     // -- Protected
@@ -305,81 +464,179 @@ namespace turret_client {
 
         }
 
+        // Build a prefetch model from previous sessions' caches
+        if (const char *prefetch_history = std::getenv(("TURRET_" + clientIDUppercase + "_PREFETCH_HISTORY").c_str())) {
+#ifdef _WIN32
+            const char pathSeparator = ';';
+#else
+            const char pathSeparator = ':';
+#endif
+            std::vector<std::string> historyInputs;
+            std::stringstream ss(prefetch_history);
+            std::string historyInput;
+            while (std::getline(ss, historyInput, pathSeparator)) {
+                if (!historyInput.empty())
+                    historyInputs.push_back(historyInput);
+            }
+
+            // Session caches are named <clientID>_<sessionID>, so a shared cache directory only
+            // contributes this client's sessions
+            std::vector<std::string> historyPaths;
+            turretCacheUtils::find_cache_files(historyInputs, historyPaths, m_clientID + "_");
+
+            const char *defaultUSD = std::getenv("DEFAULT_USD");
+            std::unique_ptr<turretPrefetcher> prefetcher(new turretPrefetcher());
+            const size_t predicted = prefetcher->load_history(historyPaths, defaultUSD ? defaultUSD : "");
+
+            if (m_doLog) {
+                turretLogger::Instance()->Log("Turret " + m_clientID + " loaded prefetch history for "
+                                              + std::to_string(predicted) + " queries from the newest "
+                                              + std::to_string(std::min(historyPaths.size(), PREFETCH_MAX_HISTORY_FILES))
+                                              + " of " + std::to_string(historyPaths.size()) + " cache files",
+                                              turretLogger::LOG_LEVELS::CACHE_FILE_IO);
+            }
+
+            if (!prefetcher->empty()) {
+                m_prefetcher = std::move(prefetcher);
+                m_prefetchPid = getProcessID();
+
+                // Started last, so nothing in setup can throw with the threads running
+                m_prefetchState.reset(new prefetchState());
+                for (int i = 0; i < PREFETCH_THREADS; ++i) {
+                    m_prefetchState->threads.push_back(std::thread(&turretClient::prefetchLoop, this));
+                }
+            }
+        }
+
     }
 
     void turretClient::destroy() {
+        // Drop queued prefetches rather than draining them. Each thread may still be waiting on one
+        // in flight prefetch, which is bounded by PREFETCH_TIMEOUT.
+        // Prefetch threads inherited across fork() don't exist in this process, so don't touch them.
+        if (m_prefetchState) {
+            if (m_prefetchPid == getProcessID()) {
+                {
+                    std::lock_guard<std::mutex> lock(m_prefetchState->mutex);
+                    m_prefetchState->stop = true;
+                    m_prefetchState->queue.clear();
+                }
+                m_prefetchState->wake.notify_all();
+
+                for (std::thread &thread : m_prefetchState->threads) {
+                    thread.join();
+                }
+
+                m_prefetchState.reset();
+            } else {
+                m_prefetchState.release();
+            }
+        }
+
         if ((m_cacheToDisk) && (!m_cachedQueries.empty())) {
             saveCache();
         }
-    }
 
-    void turretClient::saveCache() {
+        // Closing a context inherited from a parent process is unsafe, leave it to the OS
+        if (m_context && m_contextPid != getProcessID()) {
+            m_context.release();
+        }
+    }
 
-        try {
-            std::fstream fs(m_cacheFilePath.c_str(), std::fstream::out | std::ios::binary);
-            std::map<std::string, turretQueryCache> stdMapCachedQueries;
+    zmq::context_t &turretClient::getContext() {
+        tbb::mutex::scoped_lock lock(m_contextMutex);
 
-            for( tbb::concurrent_hash_map<std::string, turretQueryCache>::iterator it = m_cachedQueries.begin() ; it != m_cachedQueries.end() ; ++it ){
-                std::string query = it->first;
-                std::string realPath = it->second.resolved_path;
-                std::time_t timestamp = it->second.timestamp;
-                turretQueryCache cache = {realPath, timestamp};
-                stdMapCachedQueries.insert(std::make_pair(query, cache));
-            }
+        const long pid = getProcessID();
 
-            boost::archive::text_oarchive oarch(fs);
-            oarch << stdMapCachedQueries;
-            fs.close();
+        if (m_context && m_contextPid != pid) {
+            m_context.release();
 
             if (m_doLog) {
-                turretLogger::Instance()->Log(m_clientID + " resolver saved cache to " + m_cacheFilePath,
-                                              turretLogger::LOG_LEVELS::CACHE_FILE_IO);
+                turretLogger::Instance()->Log(m_clientID + " resolver detected fork, recreating zmq context in process "
+                                              + std::to_string(pid), turretLogger::LOG_LEVELS::ZMQ_INTERNAL);
             }
+        }
 
+        if (!m_context) {
+            m_context.reset(new zmq::context_t(1));
+            m_contextPid = pid;
         }
-        catch (boost::archive::archive_exception) {
+
+        return *m_context;
+    }
+
+    void turretClient::saveCache() {
+        writeCacheFile(m_cacheFilePath);
+    }
+
+    bool turretClient::loadCache() {
+        if (!readCacheFile(m_cacheFilePath)) {
+            return false;
+        }
+
+        m_cacheLoaded = true;
+        return true;
+    }
+
+    bool turretClient::writeCacheFile(const std::string &a_cachePath, bool a_dropFallbacks) {
+        const char *defaultUSD = std::getenv("DEFAULT_USD");
+        turretCacheMap stdMapCachedQueries;
+
+        {
+            // Iterating a concurrent_hash_map is not safe alongside lookups or inserts, see cacheFind
+            tbb::spin_rw_mutex::scoped_lock lock(m_cacheMutex, true);
+
+            for( tbb::concurrent_hash_map<std::string, turretQueryCache>::iterator it = m_cachedQueries.begin() ; it != m_cachedQueries.end() ; ++it ){
+                // Mispredictions would otherwise reinforce themselves in the next session's history
+                if (m_prefetchedUnused.count(it->first))
+                    continue;
+                if (a_dropFallbacks && turretCacheUtils::is_fallback(it->second, defaultUSD ? defaultUSD : ""))
+                    continue;
+                stdMapCachedQueries.insert(std::make_pair(it->first, it->second));
+            }
+        }
+
+        if (!turretCacheUtils::write_cache_file(a_cachePath, stdMapCachedQueries)) {
 
             if (m_doLog) {
-                turretLogger::Instance()->Log(m_clientID + " resolver could not save cache to " + m_cacheFilePath,
+                turretLogger::Instance()->Log(m_clientID + " resolver could not save cache to " + a_cachePath,
                                               turretLogger::LOG_LEVELS::CACHE_FILE_IO);
             }
 
+            return false;
         }
 
+        if (m_doLog) {
+            turretLogger::Instance()->Log(m_clientID + " resolver saved cache to " + a_cachePath,
+                                          turretLogger::LOG_LEVELS::CACHE_FILE_IO);
+        }
 
+        return true;
     }
 
-    bool turretClient::loadCache() {
-        std::fstream fs(m_cacheFilePath.c_str(), std::fstream::in | std::ios::binary);
+    bool turretClient::readCacheFile(const std::string &a_cachePath) {
+        turretCacheMap stdMapCachedQueries;
 
-        if (!fs.is_open()) {
+        if (!turretCacheUtils::read_cache_file(a_cachePath, stdMapCachedQueries)) {
 
             if (m_doLog) {
-                turretLogger::Instance()->Log(m_clientID + " resolver no cache file present on disk.",
+                turretLogger::Instance()->Log(m_clientID + " resolver could not read cache file " + a_cachePath,
                                               turretLogger::LOG_LEVELS::CACHE_FILE_IO);
             }
 
             return false;
         }
 
-        boost::archive::text_iarchive iarch(fs);
-        std::map<std::string, turretQueryCache> stdMapCachedQueries;
-        iarch >> stdMapCachedQueries;
-
-        for (std::map<std::string, turretQueryCache>::iterator it = stdMapCachedQueries.begin(); it != stdMapCachedQueries.end(); ++it){
-            std::string query = it->first;
-            std::string realPath = it->second.resolved_path;
-            std::time_t timestamp = it->second.timestamp;
-            turretQueryCache cache = {realPath, timestamp};
-// dan: not entirely sure of best practice here:
-//            tbb::concurrent_hash_map<std::string, turret_client::turretQueryCache>::accessor a;
-//            m_cachedQueries.insert(a, std::make_pair(query, cache));
-            m_cachedQueries.insert(std::make_pair(query, cache));
+        for (turretCacheMap::iterator it = stdMapCachedQueries.begin(); it != stdMapCachedQueries.end(); ++it){
+            // insert will not replace keys already resolved in this session.
+            // Keys are canonicalised so cache files written before canonical keys still match.
+            cacheInsert(turretCacheUtils::canonical_query(it->first), it->second);
         }
 
-        m_cacheLoaded = true;
-
-        fs.close();
+        if (m_doLog) {
+            turretLogger::Instance()->Log(m_clientID + " resolver loaded cache from " + a_cachePath,
+                                          turretLogger::LOG_LEVELS::CACHE_FILE_IO);
+        }
 
         return true;
     }
@@ -412,6 +669,177 @@ namespace turret_client {
     //     }
     // }
 
+    // Queues background resolves for the queries which historically followed a_query
+    void turretClient::queuePrefetches(const std::string &a_query) {
+        // Prefetching is not restarted in forked children
+        if (!m_prefetcher || m_prefetchPid != getProcessID()) {
+            return;
+        }
+
+        for (const std::string &predicted : m_prefetcher->predict(a_query)) {
+            turretQueryCache cached;
+            if (cacheFind(predicted, cached))
+                continue;
+
+            // Only queue each query once per session
+            if (!m_prefetchQueued.insert(std::make_pair(predicted, true)))
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(m_prefetchState->mutex);
+                if (m_prefetchState->stop || m_prefetchState->queue.size() >= PREFETCH_MAX_QUEUED) {
+                    m_prefetchQueued.erase(predicted);
+                    continue;
+                }
+                m_prefetchState->queue.push_back(predicted);
+            }
+            m_prefetchState->wake.notify_one();
+        }
+    }
+
+    // Prefetches block on the network, so they run on their own few threads rather than on
+    // the shared tbb pool, which the host application (eg: usd stage composition) relies on
+    void turretClient::prefetchLoop() {
+        prefetchState &state = *m_prefetchState;
+
+        while (true) {
+            std::string query;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.wake.wait(lock, [&state] { return state.stop || !state.queue.empty(); });
+                if (state.stop)
+                    return;
+
+                query = state.queue.front();
+                state.queue.pop_front();
+            }
+
+            prefetch(query);
+        }
+    }
+
+    // A single attempt, failures are left for a later resolve_name to retry and report
+    void turretClient::prefetch(const std::string &a_query) {
+        turretQueryCache cached;
+        if (cacheFind(a_query, cached))
+            return;
+
+        std::string realPath;
+        if (!sendQuery(a_query, realPath, std::min(m_timeout, PREFETCH_TIMEOUT)) || realPath == "NOT_FOUND")
+            return;
+
+        turretQueryCache cache = {realPath, std::time(0)};
+        // insert will not add duplicate keys
+        cacheInsert(a_query, cache, true);
+
+        if (m_doLog) {
+            turretLogger::Instance()->Log(m_clientID + " resolver prefetched: " + realPath + " for query: " + a_query,
+                                          turretLogger::LOG_LEVELS::ZMQ_QUERIES);
+        }
+    }
+
+    // All lookups and inserts go through cacheFind and cacheInsert. Lookups can rehash buckets as well
+    // as inserts, so both hold m_cacheMutex as readers. They still run concurrently with each other,
+    // while writeCacheFile holds it as a writer to get a consistent snapshot.
+    bool turretClient::cacheFind(const std::string &a_query, turretQueryCache &a_cache) {
+        tbb::spin_rw_mutex::scoped_lock lock(m_cacheMutex, false);
+        tbb::concurrent_hash_map<std::string, turretQueryCache>::const_accessor ac;
+        if (!m_cachedQueries.find(ac, a_query))
+            return false;
+
+        a_cache = ac->second;
+        return true;
+    }
+
+    bool turretClient::cacheInsert(const std::string &a_query, const turretQueryCache &a_cache, bool a_prefetched) {
+        tbb::spin_rw_mutex::scoped_lock lock(m_cacheMutex, false);
+        tbb::concurrent_hash_map<std::string, turretQueryCache>::accessor ac;
+        // insert will not add duplicate keys
+        if (!m_cachedQueries.insert(ac, a_query))
+            return false;
+
+        ac->second = a_cache;
+        // Marked while the accessor is held, so no lookup can see the entry before it is marked
+        if (a_prefetched)
+            m_prefetchedUnused.insert(std::make_pair(a_query, true));
+        return true;
+    }
+
+    // The first resolve of a prefetched entry makes it a normal entry, stamped with when the
+    // query was actually needed so the saved cache records the session's real resolve order
+    void turretClient::claimPrefetched(const std::string &a_query) {
+        if (m_prefetchedUnused.empty() || !m_prefetchedUnused.erase(a_query))
+            return;
+
+        tbb::spin_rw_mutex::scoped_lock lock(m_cacheMutex, false);
+        tbb::concurrent_hash_map<std::string, turretQueryCache>::accessor ac;
+        if (m_cachedQueries.find(ac, a_query))
+            ac->second.timestamp = std::time(0);
+    }
+
+    // Cache keys are the query as sent to the server, including the platform, with the
+    // parameters in canonical order
+    std::string turretClient::buildQuery(const std::string &a_query) {
+        std::string query = a_query;
+
+        // Queries that already name a platform (eg: keys in a scope reply) are left as they are
+        const size_t params = query.find('?');
+        const bool hasPlatform = params != std::string::npos
+                                 && ("&" + query.substr(params + 1)).find("&platform=") != std::string::npos;
+
+        const char *env = std::getenv("TURRET_PLATFORM_ID");
+        if (env && !hasPlatform) {
+            std::string platform = std::string(env);
+            if (!platform.empty()) {
+                query += "&platform=" + platform;
+            }
+        }
+
+        return turretCacheUtils::canonical_query(query);
+    }
+
+    bool turretClient::sendQuery(const std::string &a_query, std::string &a_reply, int a_timeout) {
+        const int timeout = (a_timeout < 0) ? m_timeout : a_timeout;
+
+        zmq::socket_t m_socket(getContext(), ZMQ_REQ);
+        m_socket.connect("tcp://" + m_serverIP + ":" + m_serverPort);
+        m_socket.setsockopt(ZMQ_LINGER, timeout);
+        m_socket.setsockopt(ZMQ_RCVTIMEO, timeout);
+
+        // Create zmq request
+        zmq::message_t request(a_query.c_str(), a_query.length());
+
+        // Send zmq request
+        m_socket.send(request/* , ZMQ_NOBLOCK */);
+
+        // Wait for the reply
+        zmq::message_t reply;
+        int result = m_socket.recv(&reply);
+
+        if (result < 1) {
+            int errnum = zmq_errno();
+            //There has been an error
+            const char *errmsg = zmq_strerror(errnum);
+
+            if (m_doLog) {
+                turretLogger::Instance()->Log(m_clientID + " resolver ZMQ ERROR: " + std::to_string(errnum)
+                                              + " : " + std::string(errmsg),
+                                              turretLogger::LOG_LEVELS::ZMQ_ERROR);
+            }
+
+            // The request is abandoned, don't let it hold up closing the shared context
+            m_socket.setsockopt(ZMQ_LINGER, 0);
+            return false;
+        }
+
+        // The reply may or may not be null terminated
+        const char *data = static_cast<const char *>(reply.data());
+        a_reply = std::string(data, std::find(data, data + reply.size(), '\0'));
+
+        m_socket.close();
+        return true;
+    }
+
     std::string turretClient::parse_query(const std::string &a_query) {
 
         std::string clientIDUppercase = m_clientID;
@@ -431,15 +859,7 @@ namespace turret_client {
         }
 
 
-        std::string query = a_query;
-
-        const char *env = std::getenv("TURRET_PLATFORM_ID");
-        if (env) {
-            std::string platform = std::string(env);
-            if (!platform.empty()) {
-                query += "&platform=" + platform;
-            }
-        }
+        const std::string query = buildQuery(a_query);
 
         for (int i = 0; i < m_retries; i++) {
             if (i > 1) {
@@ -450,17 +870,18 @@ namespace turret_client {
                 }
             }
 
-            tbb::concurrent_hash_map<std::string, turret_client::turretQueryCache>::const_accessor ac;
-            bool found = m_cachedQueries.find(ac, query);
+            turretQueryCache cached;
+            bool found = cacheFind(query, cached);
             if (found) {
+                claimPrefetched(query);
 
                 if (m_doLog) {
                     turretLogger::Instance()->Log(m_clientID + " resolver received cached response: "
-                                                  + ac->second.resolved_path + " for query: " + query
+                                                  + cached.resolved_path + " for query: " + query
                                                   + "\n", turretLogger::LOG_LEVELS::ZMQ_QUERIES);
                 }
 
-                return ac->second.resolved_path;
+                return cached.resolved_path;
             }
 
             // Halt if live resolves are disabled
@@ -473,48 +894,22 @@ namespace turret_client {
             }
 
 
-            // Perform live resolve
-
-            // Check socket status
-            zmq::context_t m_context(1);
-            zmq::socket_t m_socket(m_context, ZMQ_REQ);
-            m_socket.connect("tcp://" + m_serverIP + ":" + m_serverPort);
-            m_socket.setsockopt(ZMQ_LINGER, m_timeout);
-            m_socket.setsockopt(ZMQ_RCVTIMEO, m_timeout);
-
-            // Create zmq request
-            zmq::message_t request(query.c_str(), query.length());
-
-            // Send zmq request
-            m_socket.send(request/* , ZMQ_NOBLOCK */);
-
-            // Wait for the reply
-            zmq::message_t reply;
-            int result = m_socket.recv(&reply);
-
-            if (result < 1) {
-                int errnum = zmq_errno();
-                //There has been an error
-                const char *errmsg = zmq_strerror(errnum);
-
-                if (m_doLog) {
-                    turretLogger::Instance()->Log(m_clientID + " resolver ZMQ ERROR: " + std::to_string(errnum)
-                                                  + " : " + std::string(errmsg),
-                                                  turretLogger::LOG_LEVELS::ZMQ_ERROR);
-                }
+            if (i == 0) {
+                queuePrefetches(query);
+            }
 
+            // Perform live resolve
+            std::string realPath;
+            if (!sendQuery(query, realPath)) {
                 continue;
             }
 
-            // Store the reply
-            std::string realPath = std::string((char *) reply.data());
-
             if (realPath == "NOT_FOUND") continue;
 
             // Cache the reply
             turretQueryCache cache = {realPath, std::time(0)};
             // insert will not add duplicate keys
-            m_cachedQueries.insert(std::make_pair(query, cache));
+            cacheInsert(query, cache);
 
             if (m_doLog) {
                 turretLogger::Instance()->Log(m_clientID + " resolver received live response: "
@@ -522,13 +917,11 @@ namespace turret_client {
                                               turretLogger::LOG_LEVELS::ZMQ_QUERIES);
             }
 
-            m_socket.close();
-            m_context.close();
             return realPath;
         }
 
         turretQueryCache cache = {"NOT_FOUND", std::time(0)};
-        m_cachedQueries.insert(std::make_pair(query, cache));
+        cacheInsert(query, cache);
 
         if (m_doLog) {
             turretLogger::Instance()->Log(m_clientID + " resolver unable to query after "
@@ -541,7 +934,7 @@ namespace turret_client {
         if (const char *defaultUSD = std::getenv("DEFAULT_USD")) {
 
             turretQueryCache cache = {defaultUSD, std::time(0)};
-            m_cachedQueries.insert(std::make_pair(query, cache));
+            cacheInsert(query, cache);
 
             return defaultUSD;
         } else {
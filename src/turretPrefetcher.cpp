@@ -0,0 +1,135 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "turretPrefetcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "turretCacheUtils.h"
+
+namespace turret_client {
+
+    size_t turretPrefetcher::load_history(const std::vector<std::string> &a_cachePaths, const std::string &a_defaultUSD) {
+        typedef std::unordered_map<std::string, int> followerCounts;
+        std::unordered_map<std::string, followerCounts> coOccurrences;
+
+        // Newest files first
+        std::vector<std::pair<std::time_t, std::string>> historyFiles;
+        for (const std::string &cachePath : a_cachePaths) {
+            boost::system::error_code ec;
+            const std::time_t modified = boost::filesystem::last_write_time(cachePath, ec);
+            if (!ec)
+                historyFiles.push_back(std::make_pair(modified, cachePath));
+        }
+        std::sort(historyFiles.begin(), historyFiles.end(),
+                  [](const std::pair<std::time_t, std::string> &a, const std::pair<std::time_t, std::string> &b) {
+                      return a.first > b.first || (a.first == b.first && a.second < b.second);
+                  });
+        if (historyFiles.size() > PREFETCH_MAX_HISTORY_FILES)
+            historyFiles.resize(PREFETCH_MAX_HISTORY_FILES);
+
+        for (const auto &historyFile : historyFiles) {
+            const std::string &cachePath = historyFile.second;
+            turretCacheMap entries;
+            if (!turretCacheUtils::read_cache_file(cachePath, entries))
+                continue;
+
+            // Order the session by resolve time. Keys from older cache files may not be canonical yet.
+            std::vector<std::pair<std::time_t, std::string>> session;
+            session.reserve(entries.size());
+            for (turretCacheMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                if (!turretCacheUtils::is_fallback(it->second, a_defaultUSD)) {
+                    session.push_back(std::make_pair(it->second.timestamp, turretCacheUtils::canonical_query(it->first)));
+                }
+            }
+            std::sort(session.begin(), session.end());
+
+            // Start of each run of entries resolved in the same second
+            std::vector<size_t> seconds;
+            for (size_t i = 0; i < session.size(); ++i) {
+                if (i == 0 || session[i].first != session[i - 1].first)
+                    seconds.push_back(i);
+            }
+            seconds.push_back(session.size());
+
+            // Order within a second is unknown (the session is sorted by key there), so followers are
+            // taken a whole second at a time. The first second which would take an entry past
+            // PREFETCH_MAX_FOLLOWERS ends its window, eg: a large resolve_names batch, whose entries
+            // were requested together anyway, counts no followers rather than alphabetical neighbours.
+            for (size_t s = 0; s + 1 < seconds.size(); ++s) {
+                for (size_t i = seconds[s]; i < seconds[s + 1]; ++i) {
+                    followerCounts &counts = coOccurrences[session[i].second];
+                    size_t followers = 0;
+
+                    for (size_t f = s; f + 1 < seconds.size(); ++f) {
+                        if (session[seconds[f]].first - session[i].first > PREFETCH_WINDOW_SECONDS)
+                            break;
+
+                        followers += seconds[f + 1] - seconds[f] - (f == s ? 1 : 0);
+                        if (followers > PREFETCH_MAX_FOLLOWERS)
+                            break;
+
+                        for (size_t j = seconds[f]; j < seconds[f + 1]; ++j) {
+                            if (session[j].second != session[i].second)
+                                counts[session[j].second]++;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Keep only the most common followers of each query
+        m_predictions.clear();
+        for (const auto &query : coOccurrences) {
+            if (query.second.empty())
+                continue;
+
+            std::vector<std::pair<int, std::string>> ranked;
+            ranked.reserve(query.second.size());
+            for (const auto &follower : query.second) {
+                ranked.push_back(std::make_pair(follower.second, follower.first));
+            }
+
+            const size_t keep = std::min(ranked.size(), static_cast<size_t>(PREFETCH_MAX_PREDICTIONS));
+            std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                              [](const std::pair<int, std::string> &a, const std::pair<int, std::string> &b) {
+                                  return a.first > b.first || (a.first == b.first && a.second < b.second);
+                              });
+
+            std::vector<std::string> &predictions = m_predictions[query.first];
+            for (size_t i = 0; i < keep; ++i) {
+                predictions.push_back(ranked[i].second);
+            }
+        }
+
+        return m_predictions.size();
+    }
+
+    const std::vector<std::string> &turretPrefetcher::predict(const std::string &a_query) const {
+        static const std::vector<std::string> noPredictions;
+
+        std::unordered_map<std::string, std::vector<std::string>>::const_iterator it = m_predictions.find(a_query);
+        if (it == m_predictions.end())
+            return noPredictions;
+
+        return it->second;
+    }
+}
@@ -0,0 +1,166 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "turretClient.h"
+#include "turretCacheUtils.h"
+
+/* Tests turretCacheUtils::merge_cache_files on cache files written to a temporary directory.
+ */
+
+#define CHECK(a_condition) \
+    if (!(a_condition)) { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #a_condition << std::endl; \
+        g_failures++; \
+    }
+
+namespace {
+
+    using turret_client::turretCacheMap;
+    using turret_client::turretCacheMergeOptions;
+    using turret_client::turretCacheMergeResult;
+    using turret_client::turretCacheUtils;
+    using turret_client::turretQueryCache;
+
+    int g_failures = 0;
+
+    std::string g_tmpDir;
+
+    std::string writeInput(const std::string& a_name, const turretCacheMap& a_entries) {
+        const std::string path = g_tmpDir + "/" + a_name + turret_client::TURRET_CACHE_EXT;
+        if (!turretCacheUtils::write_cache_file(path, a_entries)) {
+            std::cerr << "could not write " << path << std::endl;
+            g_failures++;
+        }
+        return path;
+    }
+
+    turretCacheMap merge(const std::vector<std::string>& a_inputs, const turretCacheMergeOptions& a_options,
+                         turretCacheMergeResult* a_result = nullptr) {
+        const std::string output = g_tmpDir + "/merged" + turret_client::TURRET_CACHE_EXT;
+        const turretCacheMergeResult result = turretCacheUtils::merge_cache_files(a_inputs, output, a_options);
+        if (a_result)
+            *a_result = result;
+
+        turretCacheMap merged;
+        CHECK(result.written);
+        CHECK(turretCacheUtils::read_cache_file(output, merged));
+        CHECK(merged.size() == result.entries);
+        return merged;
+    }
+
+    std::string readBytes(const std::string& a_path) {
+        std::ifstream fs(a_path.c_str(), std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+    }
+
+    std::string mergeToBytes(const std::vector<std::string>& a_inputs, const std::string& a_name) {
+        const std::string output = g_tmpDir + "/" + a_name + turret_client::TURRET_CACHE_EXT;
+        CHECK(turretCacheUtils::merge_cache_files(a_inputs, output, turretCacheMergeOptions()).written);
+        return readBytes(output);
+    }
+}
+
+int main() {
+    const boost::filesystem::path tmpDir = boost::filesystem::temp_directory_path()
+                                           / boost::filesystem::unique_path("turret-merge-test-%%%%-%%%%");
+    boost::filesystem::create_directories(tmpDir);
+    g_tmpDir = tmpDir.string();
+
+    const std::string older = writeInput("older", {
+            {"tank:/s118/x?Asset=a&Step=model", turretQueryCache{"/jobs/a_model.v001.usd", 100}},
+            {"tank:/s118/x?Asset=b", turretQueryCache{"/jobs/b.v001.usd", 300}},
+            {"tank:/s118/x?Asset=tie", turretQueryCache{"/jobs/tie_a.usd", 200}},
+            {"tank:/s118/x?Asset=missing", turretQueryCache{"NOT_FOUND", 400}},
+            {"tank:/s118/x?Asset=default", turretQueryCache{"/defaults/empty.usd", 400}},
+    });
+    // Same key as older's first entry, with the parameters in a different order
+    const std::string newer = writeInput("newer", {
+            {"tank:/s118/x?Step=model&Asset=a", turretQueryCache{"/jobs/a_model.v002.usd", 200}},
+            {"tank:/s118/x?Asset=b", turretQueryCache{"/jobs/b.v000.usd", 50}},
+            {"tank:/s118/x?Asset=tie", turretQueryCache{"/jobs/tie_b.usd", 200}},
+    });
+
+    const std::string corrupt = g_tmpDir + "/corrupt" + turret_client::TURRET_CACHE_EXT;
+    std::ofstream(corrupt.c_str()) << "not a turret cache";
+
+    // Newest timestamp wins, ties are broken on the path, and keys are canonicalised across inputs
+    {
+        turretCacheMergeResult result;
+        const turretCacheMap merged = merge({older, newer, corrupt}, turretCacheMergeOptions(), &result);
+
+        CHECK(merged.size() == 5);
+        CHECK(merged.count("tank:/s118/x?Step=model&Asset=a") == 0);
+        CHECK(merged.at("tank:/s118/x?Asset=a&Step=model").resolved_path == "/jobs/a_model.v002.usd");
+        CHECK(merged.at("tank:/s118/x?Asset=b").resolved_path == "/jobs/b.v001.usd");
+        CHECK(merged.at("tank:/s118/x?Asset=tie").resolved_path == "/jobs/tie_b.usd");
+
+        // Corrupt inputs are reported and skipped
+        CHECK(result.failedInputs.size() == 1);
+        CHECK(!result.failedInputs.empty() && result.failedInputs[0] == corrupt);
+    }
+
+    // dropFallbacks removes NOT_FOUND and DEFAULT_USD entries
+    {
+        turretCacheMergeOptions options;
+        options.dropFallbacks = true;
+        options.defaultUSD = "/defaults/empty.usd";
+        const turretCacheMap merged = merge({older, newer}, options);
+
+        CHECK(merged.size() == 3);
+        CHECK(merged.count("tank:/s118/x?Asset=missing") == 0);
+        CHECK(merged.count("tank:/s118/x?Asset=default") == 0);
+    }
+
+    // minTimestamp removes stale entries before they are merged
+    {
+        turretCacheMergeOptions options;
+        options.minTimestamp = 250;
+        const turretCacheMap merged = merge({older, newer}, options);
+
+        CHECK(merged.size() == 3);
+        CHECK(merged.count("tank:/s118/x?Asset=a&Step=model") == 0);
+        CHECK(merged.at("tank:/s118/x?Asset=b").resolved_path == "/jobs/b.v001.usd");
+    }
+
+    // Output is byte identical regardless of input order
+    {
+        const std::string forwards = mergeToBytes({older, newer}, "forwards");
+        const std::string backwards = mergeToBytes({newer, older}, "backwards");
+
+        CHECK(!forwards.empty());
+        CHECK(forwards == backwards);
+    }
+
+    boost::filesystem::remove_all(tmpDir);
+
+    if (g_failures) {
+        std::cerr << g_failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,213 @@
+//
+// Copyright 2019 University of Technology, Sydney
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+// to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//   * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+//     the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <zmq.hpp>
+
+#include "turretClient.h"
+#include "turretCacheUtils.h"
+
+/* Tests turretClient::resolve_scope against a stand-in turret server, a zmq REP socket
+ * on a free local port which answers every request with a canned reply.
+ */
+
+#define CHECK(a_condition) \
+    if (!(a_condition)) { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #a_condition << std::endl; \
+        g_failures++; \
+    }
+
+namespace {
+
+    int g_failures = 0;
+
+    void setEnv(const char* a_name, const char* a_value) {
+#ifdef _WIN32
+        _putenv_s(a_name, a_value);
+#else
+        setenv(a_name, a_value, 1);
+#endif
+    }
+
+    class standInServer {
+        public:
+            standInServer() : m_context(1), m_stop(false), m_requestCount(0) {
+                std::promise<std::string> endpoint;
+                std::future<std::string> endpointFuture = endpoint.get_future();
+                m_thread = std::thread(&standInServer::serve, this, std::ref(endpoint));
+
+                // eg: tcp://127.0.0.1:45678
+                const std::string address = endpointFuture.get();
+                m_port = address.substr(address.rfind(':') + 1);
+            }
+
+            ~standInServer() {
+                m_stop = true;
+                m_thread.join();
+            }
+
+            const std::string& port() const { return m_port; }
+            int requestCount() const { return m_requestCount; }
+
+            std::string lastRequest() {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_lastRequest;
+            }
+
+            void setReply(const std::string& a_reply) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_reply = a_reply;
+            }
+
+        private:
+            void serve(std::promise<std::string>& a_endpoint) {
+                zmq::socket_t socket(m_context, ZMQ_REP);
+                socket.setsockopt(ZMQ_LINGER, 0);
+                socket.setsockopt(ZMQ_RCVTIMEO, 100);
+                socket.bind("tcp://127.0.0.1:*");
+
+                char endpoint[256];
+                size_t endpointSize = sizeof(endpoint);
+                socket.getsockopt(ZMQ_LAST_ENDPOINT, endpoint, &endpointSize);
+                a_endpoint.set_value(std::string(endpoint));
+
+                while (!m_stop) {
+                    zmq::message_t request;
+                    if (!socket.recv(&request))
+                        continue;
+
+                    std::string reply;
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_lastRequest = std::string(static_cast<char*>(request.data()), request.size());
+                        reply = m_reply;
+                    }
+                    m_requestCount++;
+
+                    zmq::message_t response(reply.c_str(), reply.length());
+                    socket.send(response);
+                }
+
+                socket.close();
+            }
+
+            zmq::context_t m_context;
+            std::thread m_thread;
+            std::atomic<bool> m_stop;
+            std::atomic<int> m_requestCount;
+            std::mutex m_mutex;
+            std::string m_port;
+            std::string m_reply;
+            std::string m_lastRequest;
+    };
+
+    // Exposes the in-memory cache
+    class testClient : public turret_client::turretClient {
+        public:
+            testClient() : turretClient("scopetest") {}
+
+            size_t cacheSize() const { return m_cachedQueries.size(); }
+
+            std::string cachedPath(const std::string& a_query) {
+                tbb::concurrent_hash_map<std::string, turret_client::turretQueryCache>::const_accessor ac;
+                if (!m_cachedQueries.find(ac, turret_client::turretCacheUtils::canonical_query(a_query)))
+                    return "";
+                return ac->second.resolved_path;
+            }
+    };
+}
+
+int main() {
+    standInServer server;
+
+    setEnv("TURRET_SERVER_IP", "127.0.0.1");
+    setEnv("TURRET_SERVER_PORT", server.port().c_str());
+    setEnv("TURRET_TIMEOUT", "5000");
+    setEnv("TURRET_RETRIES", "1");
+    setEnv("TURRET_PLATFORM_ID", "");
+    setEnv("TURRET_DO_LOG", "0");
+
+    testClient client;
+
+    // A multi-line reply populates the cache, with parameters in a different order to the scope query
+    server.setReply("tank:/s118/maya_publish_asset_cache_usd?version=latest&Step=model&Asset=building01\t/jobs/s118/building01_model.v045.usd\n"
+                    "tank:/s118/maya_publish_asset_cache_usd?version=latest&Step=rig&Asset=building01\t/jobs/s118/building01_rig.v012.usd\n");
+
+    CHECK(client.resolve_scope("tank:/s118/maya_publish_asset_cache_usd?Asset=building01") == 2);
+    CHECK(server.requestCount() == 1);
+    CHECK(server.lastRequest().find(turret_client::TURRET_SCOPE_ARG) != std::string::npos);
+    CHECK(client.cacheSize() == 2);
+    CHECK(client.cachedPath("tank:/s118/maya_publish_asset_cache_usd?Asset=building01&Step=model&version=latest")
+          == "/jobs/s118/building01_model.v045.usd");
+
+    // A later resolve for the same query, written in scene order, is a cache hit
+    CHECK(client.resolve_name("tank:/s118/maya_publish_asset_cache_usd?Asset=building01&Step=rig&version=latest")
+          == "/jobs/s118/building01_rig.v012.usd");
+    CHECK(server.requestCount() == 1);
+
+    // NOT_FOUND caches nothing
+    server.setReply("NOT_FOUND");
+    CHECK(client.resolve_scope("tank:/s118/maya_publish_asset_cache_usd?Asset=building02") == 0);
+    CHECK(server.requestCount() == 2);
+    CHECK(client.cacheSize() == 2);
+
+    // Lines without a tab cache nothing
+    server.setReply("tank:/s118/maya_publish_asset_cache_usd?Asset=building02&Step=model /jobs/s118/building02_model.v001.usd\n"
+                    "/jobs/s118/building02_rig.v001.usd");
+    CHECK(client.resolve_scope("tank:/s118/maya_publish_asset_cache_usd?Asset=building02") == 0);
+    CHECK(server.requestCount() == 3);
+    CHECK(client.cacheSize() == 2);
+
+    // With a platform set, reply keys are cached with exactly one platform parameter whether or not the server
+    // included it, so resolves from the scene (which gain the platform) are cache hits
+    setEnv("TURRET_PLATFORM_ID", "linux");
+    testClient platformClient;
+
+    server.setReply("tank:/s118/maya_publish_asset_cache_usd?Step=model&Asset=building03\t/jobs/s118/building03_model.v003.usd\n"
+                    "tank:/s118/maya_publish_asset_cache_usd?platform=linux&Step=rig&Asset=building03\t/jobs/s118/building03_rig.v002.usd\n");
+
+    CHECK(platformClient.resolve_scope("tank:/s118/maya_publish_asset_cache_usd?Asset=building03") == 2);
+    CHECK(server.requestCount() == 4);
+    CHECK(server.lastRequest().find("platform=linux") != std::string::npos);
+    CHECK(platformClient.cacheSize() == 2);
+    CHECK(platformClient.cachedPath("tank:/s118/maya_publish_asset_cache_usd?Asset=building03&Step=model&platform=linux")
+          == "/jobs/s118/building03_model.v003.usd");
+    CHECK(platformClient.cachedPath("tank:/s118/maya_publish_asset_cache_usd?Asset=building03&Step=rig&platform=linux")
+          == "/jobs/s118/building03_rig.v002.usd");
+
+    CHECK(platformClient.resolve_name("tank:/s118/maya_publish_asset_cache_usd?Asset=building03&Step=model")
+          == "/jobs/s118/building03_model.v003.usd");
+    CHECK(platformClient.resolve_name("tank:/s118/maya_publish_asset_cache_usd?Asset=building03&Step=rig")
+          == "/jobs/s118/building03_rig.v002.usd");
+    CHECK(server.requestCount() == 4);
+
+    if (g_failures) {
+        std::cerr << g_failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}